@@ -0,0 +1,55 @@
+#include <chrono>
+#include <system_error>
+
+#include "directory_scanner.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    directory_listing scan_directory(const fs::path &directory) {
+        directory_listing listing;
+
+        // directory_iterator hands back d_type from getdents64, so this never stats the entries
+        std::error_code err;
+        for (fs::directory_iterator iter{ directory, err }, end; !err && iter != end; iter.increment(err)) {
+            listing.emplace(iter->path().filename().string());
+        }
+
+        return listing;
+    }
+
+} // anonymous namespace
+
+directory_scanner::directory_scanner(fs::path directory)
+:m_directory{ std::move(directory) }
+{
+    poll();
+}
+
+void directory_scanner::start_scan(fs::file_time_type mtime) {
+    // The mtime is sampled before listing, so a change racing the scan triggers another one
+    m_pending_mtime = mtime;
+    m_pending = std::async(std::launch::async, scan_directory, m_directory);
+}
+
+bool directory_scanner::poll() {
+    bool updated = false;
+
+    if (m_pending.valid() && m_pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        m_listing = m_pending.get();
+        m_scanned_mtime = m_pending_mtime;
+        updated = true;
+    }
+
+    if (!m_pending.valid()) {
+        std::error_code err;
+        const auto mtime = fs::last_write_time(m_directory, err);
+
+        if (!err && mtime != m_scanned_mtime) {
+            start_scan(mtime);
+        }
+    }
+
+    return updated;
+}
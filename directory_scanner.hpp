@@ -0,0 +1,37 @@
+#ifndef DIRECTORY_SCANNER_HPP
+#define DIRECTORY_SCANNER_HPP
+
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <string>
+#include <unordered_set>
+
+using directory_listing = std::unordered_set<std::string>;
+
+// Lists a directory in the background and keeps the result until the directory's
+// mtime changes, so polling an unchanged directory costs a single stat.
+class directory_scanner {
+    std::filesystem::path m_directory;
+    directory_listing m_listing;
+    std::future<directory_listing> m_pending;
+    std::optional<std::filesystem::file_time_type> m_scanned_mtime;
+    std::optional<std::filesystem::file_time_type> m_pending_mtime;
+
+    void start_scan(std::filesystem::file_time_type mtime);
+
+public:
+    explicit directory_scanner(std::filesystem::path directory);
+
+    directory_scanner(const directory_scanner&) = delete;
+    directory_scanner &operator=(const directory_scanner&) = delete;
+
+    // Returns true when a new listing has become available since the last call
+    bool poll();
+
+    inline const directory_listing &listing() const noexcept {
+        return m_listing;
+    }
+};
+
+#endif // DIRECTORY_SCANNER_HPP
@@ -1,9 +1,19 @@
+#ifndef LEVENSHTEIN_HPP
+#define LEVENSHTEIN_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string_view>
+#include <limits>
 #include <locale>
+#include <utility>
 #include <gsl/gsl>
 
 #include "lmkdir_errors.hpp"
+#include "utf8.hpp"
 
 namespace DETAIL {
     
@@ -16,6 +26,10 @@ namespace DETAIL {
     inline bool char_ieq(char lhs, char rhs) noexcept {
         return tolower(lhs) == tolower(rhs);
     }
+
+    inline bool char_ieq(char32_t lhs, char32_t rhs) noexcept {
+        return fold_case(lhs) == fold_case(rhs);
+    }
     
 } // namespace DETAIL
 
@@ -29,7 +43,10 @@ struct LEVENSHTEIN_SCORE_TABLE {
     static constexpr std::int64_t consecutive_match = 15;
 };
 
-template <typename CharType, bool CaseSensitive = true, typename ScoreTable = LEVENSHTEIN_SCORE_TABLE>
+// With Sellers set, src is matched against the best-fitting substring of tgt: every row of
+// tgt starts afresh at zero and the best score of any row ending is returned. src then stays
+// on the buffer axis, so the buffers must hold src.size() + 1 entries.
+template <typename CharType, bool CaseSensitive = true, typename ScoreTable = LEVENSHTEIN_SCORE_TABLE, bool Sellers = false>
 std::int64_t modified_levenshtein_distance(std::basic_string_view<CharType> src, std::basic_string_view<CharType> tgt, 
                                            gsl::span<std::int64_t> working_buffer, gsl::span<std::byte> working_bitset) 
 {
@@ -38,7 +55,7 @@ std::int64_t modified_levenshtein_distance(std::basic_string_view<CharType> src,
     
     auto deletion = ScoreTable::deletion;
     auto insertion = ScoreTable::insertion;
-    if (src.size() > tgt.size()) {
+    if (!Sellers && src.size() > tgt.size()) {
         std::swap(src, tgt);
         std::swap(deletion, insertion);
     }
@@ -49,20 +66,17 @@ std::int64_t modified_levenshtein_distance(std::basic_string_view<CharType> src,
     const auto buffer_size = src.size() + 1u;
     const auto bitset = working_bitset.data();
 
-#if USE_SELLERS != 0
-    std::memset(buffer, 0, buffer_size);
-#else
     {
         std::int64_t n = 0;
         std::generate(buffer, buffer + buffer_size, [&n]{ return n--;});
     }
-#endif
     std::memset(bitset, 0, (src.size() + CHAR_BIT - 1u) / CHAR_BIT);
 
     std::size_t num_matches = 0u;
     std::int64_t diag = 0;
+    std::int64_t best = std::numeric_limits<std::int64_t>::min();
     for (std::size_t i = 0u; i < tgt.size(); ++i) { 
-        diag = std::exchange(buffer[0u], -static_cast<std::int64_t>(i + 1u));
+        diag = std::exchange(buffer[0u], Sellers ? 0 : -static_cast<std::int64_t>(i + 1u));
 
         for (std::size_t j = 0u; j < src.size(); ++j) {
             const auto bitoffset = j / CHAR_BIT;
@@ -91,19 +105,25 @@ std::int64_t modified_levenshtein_distance(std::basic_string_view<CharType> src,
                 bitset[bitoffset] &= ~bitmask;
             }
         }
+
+        if constexpr (Sellers) {
+            best = std::max(best, buffer[src.size()]);
+        }
     }
 
-    return buffer[src.size()];
+    return Sellers ? best : buffer[src.size()];
 }
 
-template <typename CharType, bool CaseSensitive = true, typename ScoreTable = LEVENSHTEIN_SCORE_TABLE>
+template <typename CharType, bool CaseSensitive = true, typename ScoreTable = LEVENSHTEIN_SCORE_TABLE, bool Sellers = false>
 inline std::int64_t modified_levenshtein_distance(std::basic_string_view<CharType> src, std::basic_string_view<CharType> tgt) {
-    auto size = std::min(src.size(), tgt.size()) + 1u;
+    auto size = (Sellers ? src.size() : std::min(src.size(), tgt.size())) + 1u;
     auto buffer = std::make_unique<std::int64_t[]>(size);
     auto size_bytes = (size + CHAR_BIT - 1u) / CHAR_BIT;
     auto bitset = std::make_unique<std::byte[]>(size_bytes);
 
-    return modified_levenshtein_distance<CharType, CaseSensitive, ScoreTable>(src, tgt, 
-                                                                              gsl::make_span(buffer.get(), size), 
-                                                                              gsl::make_span(bitset.get(), size_bytes));
-}
\ No newline at end of file
+    return modified_levenshtein_distance<CharType, CaseSensitive, ScoreTable, Sellers>(src, tgt, 
+                                                                                       gsl::make_span(buffer.get(), size), 
+                                                                                       gsl::make_span(bitset.get(), size_bytes));
+}
+
+#endif // LEVENSHTEIN_HPP
\ No newline at end of file
@@ -1,63 +1,221 @@
 #define FAKE_CREATE_DIRECTORY 0
-#define USE_LEVENSHTEIN 1
-#define USE_SELLERS 0
 
 #include "lmkdir.hpp"
-#include "levenshtein.hpp"
+#include "directory_scanner.hpp"
+#include "lmkdir_daemon.hpp"
+#include "manifest_federation.hpp"
+#include "metadata_service.hpp"
+#include "utf8.hpp"
 
 constexpr char const* const manifest_name = "lmkdir_manifest";
 constexpr int esc_char = 27;
 constexpr int del_char = 127;
+constexpr int idle_timeout_ms = 100;
+constexpr std::size_t prefetch_pages = 2u;
 
 namespace fs = std::filesystem;
-using directory_manifest = std::vector<std::string>;
 
-class manifest_manager {
-    std::unordered_map<std::string, ITEM*> m_data;
+std::string format_size(std::uint64_t size) {
+    constexpr char units[] = "BKMGTP";
 
-public:
-    manifest_manager(directory_manifest&& initial_names) {
-        m_data.reserve(initial_names.size());
+    auto value = static_cast<double>(size);
+    std::size_t unit = 0u;
+    while (value >= 1024.0 && unit + 2u < sizeof(units)) {
+        value /= 1024.0;
+        ++unit;
+    }
+
+    char buff[32];
+    std::snprintf(buff, sizeof(buff), unit == 0u ? "%.0f%c" : "%.1f%c", value, units[unit]);
+    return buff;
+}
+
+std::string format_metadata(const entry_metadata &metadata) {
+    if (!metadata.exists) return "missing";
+
+    const std::time_t mtime = metadata.mtime;
+    std::tm local_mtime;
+    localtime_r(&mtime, &local_mtime);
+
+    char buff[32];
+    std::strftime(buff, sizeof(buff), "%Y-%m-%d %H:%M", &local_mtime);
+
+    std::string description{ buff };
+    if (!metadata.is_directory) {
+        description += "  file";
+    }
+    if (metadata.size) {
+        description += metadata.size_truncated ? "  >" : "  ";
+        description += format_size(*metadata.size);
+    }
+
+    return description;
+}
+
+// The one place lmkdir reaches into ncurses internals. The menu library has no setter
+// for an item's description, so this rewrites the TEXT {str, length} pair of the ITEM
+// struct, which <menu.h> declares publicly in ncurses 5.x and 6.x (checked against 6.4).
+// The menu only picks up the new width on its next set_menu_items(), and description
+// must outlive the item or the next call here.
+void replace_item_description(ITEM* item, const std::string &description) {
+    static_assert(std::is_same_v<decltype(item->description.str), const char*>,
+                  "ITEM::description layout differs from ncurses 5.x/6.x");
+    static_assert(std::is_same_v<decltype(item->description.length), unsigned short>,
+                  "ITEM::description layout differs from ncurses 5.x/6.x");
+
+    item->description.str = description.c_str();
+    item->description.length = gsl::narrow<unsigned short>(description.size());
+}
+
+struct manifest_entry {
+    ITEM* item = nullptr;
+    std::string description;
+    std::optional<entry_metadata> metadata;
+    std::uint64_t metadata_ticket = 0u;  // 0 until metadata is requested
+};
+
+// Owns the menu items, created on demand for whatever names the engine ranks
+class manifest_manager {
+    std::unordered_map<std::string, manifest_entry> m_data;
+    std::vector<ITEM*> m_retired_items;
+    const directory_listing* m_listing = nullptr;
+    std::string m_key;
+
+    metadata_service &m_metadata;
+    std::uint64_t m_next_ticket = 1u;
+    std::vector<metadata_request> m_requests;
+    std::vector<metadata_result> m_results;
+
+    static void set_item_description(manifest_entry &entry, std::string_view description) {
+        if (entry.description == description) return;
+        entry.description = description;
+        replace_item_description(entry.item, entry.description);
+    }
 
-        for (auto &name : initial_names) {
-            add_name(std::move(name));
+    // Metadata wins once it arrives. Until then, fall back to the directory listing;
+    // nested names cannot be answered from a single listing and are left unmarked.
+    void describe(const std::string &name, manifest_entry &entry) {
+        if (entry.metadata) {
+            set_item_description(entry, format_metadata(*entry.metadata));
+            return;
         }
 
-        initial_names.clear();
+        if (m_listing == nullptr || name.find('/') != std::string::npos) return;
+        set_item_description(entry, m_listing->count(name) != 0u ? "exists" : "missing");
+    }
+
+    // Drops cached metadata; results already in flight no longer match the ticket
+    static void invalidate(manifest_entry &entry) {
+        entry.metadata.reset();
+        entry.metadata_ticket = 0u;
+    }
+
+public:
+    explicit manifest_manager(metadata_service &metadata)
+    :m_metadata{ metadata }
+    {
+        m_key.reserve(256);
     }
 
     ~manifest_manager() {
+        free_retired_items();
+
         for (auto &pair : m_data) {
-            free_item(pair.second);
+            free_item(pair.second.item);
         }
     }
 
     manifest_manager(const manifest_manager&) = delete;
     manifest_manager &operator=(const manifest_manager&) = delete;
 
-    template <typename T>
-    void add_name(T &&name) {
-        auto [iter, is_new_name] = m_data.emplace(std::forward<T>(name), nullptr);
+    ITEM* item(std::string_view name) {
+        m_key.assign(name);
+
+        // try_emplace only builds a node for a name not seen before; this runs for every ranked name on every keystroke
+        auto [iter, is_new_name] = m_data.try_emplace(m_key);
         if (is_new_name) {
-            iter->second = new_item(iter->first.c_str(), "");
-            RUNTIME_ASSERT(iter->second);
+            iter->second.item = new_item(iter->first.c_str(), "");
+            RUNTIME_ASSERT(iter->second.item);
+            describe(iter->first, iter->second);
         }
+
+        return iter->second.item;
     }
 
-    void remove_name(const std::string &name) {
-        auto iter = m_data.find(name);
+    void remove_name(std::string_view name) {
+        m_key.assign(name);
+
+        auto iter = m_data.find(m_key);
         if (iter != m_data.end()) {
-            free_item(iter->second);
+            // The item may still be connected to the menu, which makes free_item() fail
+            m_retired_items.emplace_back(iter->second.item);
             m_data.erase(iter);
         }
     }
 
-    inline const auto &range() const noexcept {
-        return m_data;
+    // Frees removed items; call once the menu no longer references them
+    void free_retired_items() {
+        for (auto item : m_retired_items) {
+            free_item(item);
+        }
+        m_retired_items.clear();
+    }
+
+    // Hash join of the items against the on-disk listing. Items created later are
+    // probed as they are made, so the listing must outlive this manager.
+    void mark_existing(const directory_listing &on_disk) {
+        m_listing = &on_disk;
+
+        for (auto &[name, entry] : m_data) {
+            // The directory changed under cached metadata, have it fetched again
+            if (entry.metadata && name.find('/') == std::string::npos && entry.metadata->exists != (on_disk.count(name) != 0u)) {
+                invalidate(entry);
+            }
+            describe(name, entry);
+        }
+    }
+
+    void invalidate_metadata(std::string_view name) {
+        m_key.assign(name);
+
+        auto iter = m_data.find(m_key);
+        if (iter != m_data.end()) {
+            invalidate(iter->second);
+            describe(iter->first, iter->second);
+        }
+    }
+
+    // Asks for metadata on the items in [first, last) that have none cached or pending
+    void request_metadata(ITEM* const* first, ITEM* const* last, bool urgent) {
+        for (; first != last; ++first) {
+            if (*first == nullptr) continue;
+            m_key.assign(item_name(*first));
+
+            auto iter = m_data.find(m_key);
+            if (iter == m_data.end() || iter->second.metadata_ticket != 0u) continue;
+
+            iter->second.metadata_ticket = m_next_ticket++;
+            m_requests.emplace_back(iter->first, iter->second.metadata_ticket);
+        }
+
+        m_metadata.request(m_requests, urgent);
     }
 
-    inline std::size_t size() const noexcept {
-        return m_data.size();
+    // Applies the metadata that has arrived; returns true if any description changed
+    bool poll_metadata() {
+        m_metadata.drain(m_results);
+
+        bool changed = false;
+        for (auto &res : m_results) {
+            auto iter = m_data.find(res.name);
+            if (iter == m_data.end() || iter->second.metadata_ticket != res.ticket) continue;
+
+            iter->second.metadata = std::move(res.metadata);
+            describe(iter->first, iter->second);
+            changed = true;
+        }
+
+        return changed;
     }
 };
 
@@ -80,31 +238,36 @@ public:
 };
 
 class menu_manager {
+public:
+    enum IDLE_ACTION { NONE, REPAINT, REQUERY };
+
+private:
     std::vector<ITEM*> m_visible_items;
     std::vector<ITEM*> m_items_back_buffer;
-    std::vector<std::int64_t> m_levenshtein_buffer;
-    std::vector<std::byte> m_levenshtein_bitset;
     std::string m_char_buffer;
     std::string m_status_bar;
 
     manifest_manager &m_manifest_manager;
+    manifest_engine &m_engine;
+    std::function<IDLE_ACTION()> m_idle_handler;
     MENU* m_menu;
     ITEM* m_curr_item;
     bool m_posted = false;
 
+    std::size_t m_page_rows;
     int status_bar_y;
     int sep2_y;
     int input_bar_y;
     int sep1_y;
 
-    void post_all_items() {
+    void post_items(const std::vector<std::string_view> &names) {
         std::swap(m_visible_items, m_items_back_buffer);
 
         m_visible_items.clear();
         m_visible_items.emplace_back(m_curr_item);
-        
-        for (const auto &[str, item] : m_manifest_manager.range()) {
-            m_visible_items.emplace_back(item);
+
+        for (const auto name : names) {
+            m_visible_items.emplace_back(m_manifest_manager.item(name));
         }
 
         m_visible_items.emplace_back(nullptr);
@@ -133,86 +296,90 @@ class menu_manager {
         post_func();
 
         CHECK_MENU_OK(set_menu_items(m_menu, m_visible_items.data()));
+        m_manifest_manager.free_retired_items();
         CHECK_MENU_OK(post_menu(m_menu));
         m_posted = true;
 
         CHECK_OK(refresh());
+        request_visible_metadata();
+    }
+
+    // The page on screen goes first, then a few pages below it
+    void request_visible_metadata() {
+        const auto num_items = m_visible_items.size() - 1u;
+        const auto top = std::min(gsl::narrow<std::size_t>(std::max(top_row(m_menu), 0)), num_items);
+        const auto page_end = std::min(top + m_page_rows, num_items);
+        const auto prefetch_end = std::min(page_end + prefetch_pages * m_page_rows, num_items);
+
+        const auto items = m_visible_items.data();
+        m_manifest_manager.request_metadata(items + top, items + page_end, true);
+        m_manifest_manager.request_metadata(items + page_end, items + prefetch_end, false);
+    }
+
+    void navigate(int request) {
+        menu_driver(m_menu, request);
+        request_visible_metadata();
     }
     
     void reset() {
-        update([this]() { this->post_all_items(); });
+        edit({});
     }
 
-#if USE_LEVENSHTEIN != 0
     void edit(std::string_view curr_str) {
-        std::vector<std::pair<std::int64_t, ITEM*>> results;
-        m_levenshtein_buffer.resize(curr_str.size() + 1);
-        m_levenshtein_bitset.resize((curr_str.size() + CHAR_BIT - 1) / CHAR_BIT);
-
-        for (const auto &[str, item] : m_manifest_manager.range()) {
-            auto &back = results.emplace_back(std::numeric_limits<std::int64_t>::max(), item);
-            
-            if (!boost::ifind_first(str, curr_str)) {
-                back.first = modified_levenshtein_distance<char, false>(curr_str, str, m_levenshtein_buffer, m_levenshtein_bitset);
-            }
-        }
-
-        std::sort(results.begin(), results.end(), 
-                  [](const auto &lhs, const auto &rhs){ return lhs.first > rhs.first; });
-
-        auto post = [&]() {
-            std::swap(m_visible_items, m_items_back_buffer);
+        const auto &names = m_engine.rank(curr_str);
+        update([&]() { this->post_items(names); });
+    }
 
-            m_visible_items.clear();
-            m_visible_items.emplace_back(m_curr_item);
+    // Rerun the current query against the manifest, keeping the selection if it survived
+    void redraw() {
+        ITEM* item = current_item(m_menu);
 
-            for (const auto &pair : results) {
-                m_visible_items.emplace_back(pair.second);
-            }
+        if (m_char_buffer.empty()) {
+            reset();
+        }
+        else {
+            edit(m_char_buffer);
+        }
 
-            m_visible_items.emplace_back(nullptr);
-        };
-        update(post);
+        if (item != nullptr && std::find(m_visible_items.begin(), m_visible_items.end(), item) != m_visible_items.end()) {
+            set_current_item(m_menu, item);
+            CHECK_OK(refresh());
+        }
     }
-#else
-    void edit(std::string_view curr_str) {
-        auto post = [&]() {
-            std::swap(m_visible_items, m_items_back_buffer);
 
-            m_visible_items.clear();
-            m_visible_items.emplace_back(m_curr_item);
+    // Repost the visible items as they are, picking up new descriptions
+    void repaint() {
+        ITEM* item = current_item(m_menu);
+        const int top = top_row(m_menu);
 
-            for (const auto &[str, item] : m_manifest_manager.range()) {
-                if (boost::ifind_first(str, curr_str)) {
-                    m_visible_items.emplace_back(item);
-                }
-            }
+        update([]() {});
 
-            m_visible_items.emplace_back(nullptr);
-        };
-        update(post);
+        set_top_row(m_menu, top);
+        if (item != nullptr) {
+            set_current_item(m_menu, item);
+        }
+        CHECK_OK(refresh());
     }
-#endif
 
 public:
-    menu_manager(manifest_manager &manifest_manager)
-    :m_manifest_manager{ manifest_manager }
+    menu_manager(manifest_manager &manifest_manager, manifest_engine &engine)
+    :m_manifest_manager{ manifest_manager },
+     m_engine{ engine }
     {
         m_char_buffer.reserve(1024);
         m_visible_items.reserve(100);
         m_items_back_buffer.reserve(100);
-        m_levenshtein_buffer.reserve(1024);
-        m_levenshtein_bitset.reserve(128);
 
         m_curr_item = new_item("<Current>", "");
         RUNTIME_ASSERT(m_curr_item != nullptr);
 
-        post_all_items();
+        post_items(m_engine.rank({}));
 
         m_menu = new_menu(m_visible_items.data());
         RUNTIME_ASSERT(m_menu != nullptr);
 
-        CHECK_MENU_OK(set_menu_format(m_menu, LINES - 7, 1));
+        m_page_rows = gsl::narrow<std::size_t>(std::max(LINES - 7, 1));
+        CHECK_MENU_OK(set_menu_format(m_menu, gsl::narrow<int>(m_page_rows), 1));
 
         status_bar_y = LINES - 2;
         sep2_y = LINES - 3;
@@ -229,6 +396,12 @@ public:
     menu_manager(const menu_manager&) = delete;
     menu_manager &operator=(const menu_manager&) = delete;
 
+    // Called whenever getch() times out; the IDLE_ACTION returned says how much to redraw
+    template <typename IdleFunc>
+    void on_idle(IdleFunc &&idle_func) {
+        m_idle_handler = std::forward<IdleFunc>(idle_func);
+    }
+
     std::optional<result> next() {
         m_char_buffer.clear();
         reset();
@@ -240,17 +413,32 @@ public:
             case esc_char:
                 return std::nullopt;
 
+            case ERR:
+                if (m_idle_handler) {
+                    switch (m_idle_handler()) {
+                    case REQUERY:
+                        redraw();
+                        break;
+                    case REPAINT:
+                        repaint();
+                        break;
+                    case NONE:
+                        break;
+                    }
+                }
+                break;
+
             case KEY_DOWN:
-                menu_driver(m_menu, REQ_DOWN_ITEM);
+                navigate(REQ_DOWN_ITEM);
                 break;
             case KEY_UP:
-                menu_driver(m_menu, REQ_UP_ITEM);
+                navigate(REQ_UP_ITEM);
                 break;
             case KEY_HOME:
-                menu_driver(m_menu, REQ_FIRST_ITEM);
+                navigate(REQ_FIRST_ITEM);
                 break;
             case KEY_END:
-                menu_driver(m_menu, REQ_LAST_ITEM);
+                navigate(REQ_LAST_ITEM);
                 break;
 
             case int('\n'):
@@ -289,6 +477,10 @@ public:
 
             case KEY_BACKSPACE:
                 if (!m_char_buffer.empty()) {
+                    // Drop a whole UTF-8 sequence: its continuation bytes, then the lead byte
+                    while (m_char_buffer.size() > 1u && (static_cast<unsigned char>(m_char_buffer.back()) & 0xC0u) == 0x80u) {
+                        m_char_buffer.pop_back();
+                    }
                     m_char_buffer.pop_back();
 
                     if (m_char_buffer.empty()) {
@@ -302,7 +494,16 @@ public:
 
             default:
                 {
-                    if (isalnum(c) || c == '_' || c == ' ') {
+                    if (c >= 0x80 && c <= 0xFF) {
+                        // getch() hands over UTF-8 a byte at a time; wait for the whole code point
+                        m_char_buffer += static_cast<char>(c);
+                        if (utf8_incomplete_tail(m_char_buffer) == 0u) {
+                            // Folded, as ASCII is lowercased below, so "ÉCOLE" types "école"
+                            utf8_fold_last(m_char_buffer);
+                            edit(m_char_buffer);
+                        }
+                    }
+                    else if (isalnum(c) || c == '_' || c == ' ') {
                         c = tolower(c);
                         m_char_buffer += c;
                         edit(m_char_buffer);
@@ -313,31 +514,37 @@ public:
     }
 
     void notify(const result &res, bool success) {
+        // res.name() is the item's name, owned by the manifest_manager entry that a successful delete erases
+        const std::string name{ res.name() };
+
         if (res.action() == result::CREATE) {
+            m_manifest_manager.invalidate_metadata(name);
+
             if (success) {
-                m_manifest_manager.add_name(res.name());
+                m_engine.add_name(name);
     
                 m_status_bar = "Successfully created directory \"";
-                m_status_bar += res.name();
+                m_status_bar += name;
                 m_status_bar += "\"";
             }
             else {
                 m_status_bar = "Failed to create directory \"";
-                m_status_bar += res.name();
+                m_status_bar += name;
                 m_status_bar += "\"";
             }
         }
         else if (res.action() == result::DELETE) {
             if (success) {
-                m_manifest_manager.remove_name(std::string{ res.name() });
+                m_engine.remove_name(name);
+                m_manifest_manager.remove_name(name);
     
                 m_status_bar = "Successfully deleted directory \"";
-                m_status_bar += res.name();
+                m_status_bar += name;
                 m_status_bar += "\"";
             }
             else {
                 m_status_bar = "Failed to delete directory \"";
-                m_status_bar += res.name();
+                m_status_bar += name;
                 m_status_bar += "\"";
             }
         }
@@ -345,51 +552,6 @@ public:
 
 };
 
-std::string_view strip(std::string_view str) {
-    auto offset = str.find_first_not_of(" \t");
-    if (offset != std::string_view::npos) {
-        str = str.substr(offset);
-    }
-
-    offset = str.find_last_not_of(" \t/");
-    if (offset != std::string_view::npos) {
-        str = str.substr(0, offset + 1);
-    }
-
-    return str;
-}
-
-directory_manifest read_directory_manifest(const std::string_view filename) {
-    std::string contents;
-
-    {
-        std::ifstream fs{ filename.data(), std::ios_base::binary | std::ios_base::ate };
-        RUNTIME_MSG_ASSERT(fs, filename);
-
-        const auto filesize = fs.tellg();
-        contents.resize(gsl::narrow<std::size_t>(filesize));
-
-        fs.seekg(0);
-        RUNTIME_MSG_ASSERT(fs, filename);
-
-        fs.read(contents.data(), filesize);
-        RUNTIME_MSG_ASSERT(fs, filename);
-    }
-
-    auto range_of_names = contents
-                          | boost::adaptors::tokenized(boost::regex("[^\\r\\n]+"))
-                          | boost::adaptors::transformed([](auto &rng) { return std::string_view{ &*rng.begin(), gsl::narrow<std::size_t>(rng.end() - rng.begin()) }; })
-                          | boost::adaptors::transformed(strip);
-
-    directory_manifest manifest{ range_of_names.begin(), range_of_names.end() };
-    std::sort(manifest.begin(), manifest.end());
-
-    auto new_end = std::unique(manifest.begin(), manifest.end());
-    manifest.erase(new_end, manifest.end());
-
-    return manifest;
-}
-
 bool create_directory(const std::string_view dirname) {
 #if FAKE_CREATE_DIRECTORY == 0
     try {
@@ -413,34 +575,6 @@ bool delete_directory(const std::string_view dirname) {
     return true;
 }
 
-void write_directory_manifest(const std::string_view filename, const manifest_manager &manifest_man) {
-    auto tmp_filename = std::string{ filename } + ".tmp";
-    {
-        std::vector<std::string_view> man;
-        man.reserve(manifest_man.size());
-    
-        for (const auto &[str, item] : manifest_man.range()) {
-            man.emplace_back(str);
-        }
-        std::sort(man.begin(), man.end());
-    
-        std::ofstream fs{ tmp_filename.data(), std::ios_base::binary };
-        RUNTIME_MSG_ASSERT(fs, tmp_filename);
-    
-        for (const auto &name : man) {
-            fs << name << "\n";
-            RUNTIME_MSG_ASSERT(fs, tmp_filename);
-        }
-    
-        fs.flush();
-        RUNTIME_MSG_ASSERT(fs, tmp_filename);
-    }
-    
-    std::error_code err;
-    fs::rename(tmp_filename, filename, err);
-    RUNTIME_MSG_ASSERT(!err, filename);
-}
-
 std::optional<std::string> get_real_executable_name() {
     char buff[PATH_MAX];
     ssize_t len = readlink("/proc/self/exe", buff, PATH_MAX-1);
@@ -452,62 +586,151 @@ std::optional<std::string> get_real_executable_name() {
     return std::nullopt;
 }
 
-std::optional<std::string> get_manifest_filename(const std::string_view exe_name) {
-    fs::path manifest_file{ manifest_name };
-    if (fs::exists(manifest_file) && !fs::is_directory(manifest_file)) {
-        return manifest_file.string();
+std::optional<fs::path> get_user_config_dir() {
+    if (const char* config_home = std::getenv("XDG_CONFIG_HOME")) {
+        return fs::path{ config_home };
     }
-    
-    manifest_file = exe_name;
-    manifest_file.replace_filename(manifest_name);
-    if (fs::exists(manifest_file) && !fs::is_directory(manifest_file)) {
-        return manifest_file.string();
+    if (const char* home = std::getenv("HOME")) {
+        return fs::path{ home } / ".config";
     }
-    
+
+    return std::nullopt;
+}
+
+// Every manifest in scope, nearest first: the project's in the CWD, the user's, then the
+// site-wide ones next to the executable. Paths are canonical so the daemon can share them.
+std::vector<std::string> get_manifest_filenames(const std::string_view exe_name) {
+    std::vector<fs::path> candidates;
+    candidates.emplace_back(manifest_name);
+
+    if (auto config_dir = get_user_config_dir()) {
+        candidates.emplace_back(*config_dir / "lmkdir" / manifest_name);
+    }
+
+    candidates.emplace_back(exe_name);
+    candidates.back().replace_filename(manifest_name);
+
     if (auto real_exe_name = get_real_executable_name()) {
-        manifest_file = *real_exe_name;
-        manifest_file.replace_filename(manifest_name);
-        
-        if (fs::exists(manifest_file) && !fs::is_directory(manifest_file)) {
-            return manifest_file.string();
+        candidates.emplace_back(*real_exe_name);
+        candidates.back().replace_filename(manifest_name);
+    }
+
+    std::vector<std::string> filenames;
+    for (const auto &manifest_file : candidates) {
+        std::error_code err;
+        if (!fs::exists(manifest_file, err) || fs::is_directory(manifest_file, err)) continue;
+
+        auto filename = fs::canonical(manifest_file, err).string();
+        if (!err && std::find(filenames.begin(), filenames.end(), filename) == filenames.end()) {
+            filenames.emplace_back(std::move(filename));
         }
     }
-    
-    return std::nullopt;
+
+    return filenames;
 }
 
-void lmkdir(const std::string_view exe_name) {
+void lmkdir(const std::string_view exe_name, matcher_kind matcher) {
     struct screen_init_ {
         screen_init_() {
+            std::setlocale(LC_ALL, "");
             initscr();
             CHECK_OK(cbreak());
             CHECK_OK(noecho());
             CHECK_OK(keypad(stdscr, TRUE));
+            timeout(idle_timeout_ms);
         }
         ~screen_init_() { endwin(); }
     } screen_init;
 
-    auto manifest_file = get_manifest_filename(exe_name);
-    RUNTIME_ASSERT(manifest_file);
+    const auto manifest_files = get_manifest_filenames(exe_name);
+    RUNTIME_MSG_ASSERT(!manifest_files.empty(), "No lmkdir_manifest found");
+
+    manifest_cache indexes;
+    const auto make_local_engine = [&]() -> std::unique_ptr<manifest_engine> {
+        return std::make_unique<federated_engine>(indexes.open(manifest_files), matcher);
+    };
 
-    manifest_manager manifest_man{ read_directory_manifest(*manifest_file) };
-    menu_manager menu_man{ manifest_man };
+    std::unique_ptr<manifest_engine> engine = daemon_client::connect(daemon_socket_path(), manifest_files, matcher, make_local_engine);
+    if (!engine) {
+        engine = make_local_engine();
+    }
+
+    directory_scanner scanner{ fs::current_path() };
+    metadata_service metadata;
+    manifest_manager manifest_man{ metadata };
+    menu_manager menu_man{ manifest_man, *engine };
+
+    menu_man.on_idle([&]() {
+        const bool manifest_changed = engine->poll();
 
-    while (auto opt = menu_man.next()) {
-        if (opt->action() == result::CREATE) {
-            menu_man.notify(*opt, create_directory(opt->name()));
+        const bool listing_changed = scanner.poll();
+        if (listing_changed) {
+            manifest_man.mark_existing(scanner.listing());
         }
-        else if (opt->action() == result::DELETE) {
-            menu_man.notify(*opt, delete_directory(opt->name()));
+
+        const bool metadata_changed = manifest_man.poll_metadata();
+
+        if (manifest_changed) return menu_manager::REQUERY;
+        return (listing_changed || metadata_changed) ? menu_manager::REPAINT : menu_manager::NONE;
+    });
+
+    try {
+        while (auto opt = menu_man.next()) {
+            if (opt->action() == result::CREATE) {
+                menu_man.notify(*opt, create_directory(opt->name()));
+            }
+            else if (opt->action() == result::DELETE) {
+                menu_man.notify(*opt, delete_directory(opt->name()));
+            }
+        }
+    } catch (...) {
+        // Keep the names this session added even if it ends on an error; the original error wins
+        try {
+            engine->persist();
+        } catch (const std::exception&) {
         }
+        throw;
     }
 
-    write_directory_manifest(*manifest_file, manifest_man);
+    engine->persist();
 }
 
-int main(int, char const* const* const argv) {
+matcher_kind get_matcher_kind(std::string_view name) {
+    auto matcher = parse_matcher_kind(name);
+    RUNTIME_MSG_ASSERT(matcher, "Unknown matcher \"" + std::string{ name } + "\"");
+    return *matcher;
+}
+
+int main(int argc, char const* const* const argv) {
     try {
-        lmkdir(argv[0]);
+        constexpr std::string_view matcher_flag = "--matcher=";
+        bool daemon = false;
+
+        auto matcher = matcher_kind::LEVENSHTEIN;
+        if (const char* name = std::getenv("LMKDIR_MATCHER")) {
+            matcher = get_matcher_kind(name);
+        }
+
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg{ argv[i] };
+
+            if (arg == "--daemon") {
+                daemon = true;
+            }
+            else if (arg.substr(0, matcher_flag.size()) == matcher_flag) {
+                matcher = get_matcher_kind(arg.substr(matcher_flag.size()));
+            }
+            else {
+                RUNTIME_ERROR("Unknown argument \"" + std::string{ arg } + "\"");
+            }
+        }
+
+        if (daemon) {
+            run_daemon(daemon_socket_path());
+        }
+        else {
+            lmkdir(argv[0], matcher);
+        }
     }
     catch (const fatal_error &err) {
         std::cerr << "Error: " << err.what() << '\n';
@@ -1,9 +1,13 @@
 #ifndef LMKDIR_HPP
 #define LMKDIR_HPP
 
+#include <clocale>
+#include <cstdio>
 #include <cstdlib>
+#include <ctime>
 #include <algorithm>
 #include <fstream>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -11,6 +15,7 @@
 #include <unordered_map>
 #include <iostream>
 #include <filesystem>
+#include <functional>
 
 #include <boost/algorithm/string/find.hpp>
 #include <boost/range/adaptor/transformed.hpp>
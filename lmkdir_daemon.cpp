@@ -0,0 +1,555 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <unordered_map>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "lmkdir.hpp"
+#include "lmkdir_daemon.hpp"
+
+namespace fs = std::filesystem;
+
+// Wire format, native byte order since both ends share the machine:
+//   frame    := u32 size, body
+//   request  := u8 opcode, arguments
+//   string   := u32 size, bytes
+// OPEN takes the u8 protocol_version, the u8 matcher_kind used to rank for
+// this client, then a u32 count of canonical manifest paths followed by the paths.
+// Replies to RANK are u32 count followed by that many strings, OPEN and
+// GENERATION reply with the u64 generation, PERSIST with a u8 status and an
+// error message (empty on success), everything else with a u8 status.
+
+namespace {
+
+    enum class opcode : std::uint8_t {
+        OPEN,
+        RANK,
+        ADD_NAME,
+        REMOVE_NAME,
+        PERSIST,
+        GENERATION
+    };
+
+    // Bump on any change to the wire format. The high bit keeps it distinct from the
+    // matcher byte that led OPEN before the version was added.
+    constexpr std::uint8_t protocol_version = 0x81;
+
+    constexpr std::uint32_t max_frame_size = 1u << 30;
+    constexpr int poll_timeout_ms = 100;
+
+    // How long the UI waits on a reply before giving up on the daemon for the session
+    constexpr timeval reply_timeout{ 2, 0 };
+
+    volatile std::sig_atomic_t stop_requested = 0;
+
+    template <typename T>
+    void put_value(std::string &frame, T value) {
+        frame.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void put_string(std::string &frame, std::string_view str) {
+        put_value(frame, gsl::narrow<std::uint32_t>(str.size()));
+        frame.append(str);
+    }
+
+    void begin_frame(std::string &frame) {
+        frame.assign(sizeof(std::uint32_t), '\0');
+    }
+
+    class frame_reader {
+        std::string_view m_data;
+
+    public:
+        explicit frame_reader(std::string_view data)
+        :m_data{ data }
+        {}
+
+        template <typename T>
+        T get_value() {
+            RUNTIME_ASSERT(m_data.size() >= sizeof(T));
+
+            T value;
+            std::memcpy(&value, m_data.data(), sizeof(T));
+            m_data.remove_prefix(sizeof(T));
+            return value;
+        }
+
+        std::string_view get_string() {
+            const auto size = get_value<std::uint32_t>();
+            RUNTIME_ASSERT(m_data.size() >= size);
+
+            auto str = m_data.substr(0u, size);
+            m_data.remove_prefix(size);
+            return str;
+        }
+    };
+
+    bool read_all(int fd, char* data, std::size_t size) {
+        while (size != 0u) {
+            const auto len = read(fd, data, size);
+            if (len < 0 && errno == EINTR) continue;
+            if (len <= 0) return false;
+
+            data += len;
+            size -= static_cast<std::size_t>(len);
+        }
+        return true;
+    }
+
+    bool write_all(int fd, const char* data, std::size_t size) {
+        while (size != 0u) {
+            const auto len = send(fd, data, size, MSG_NOSIGNAL);
+            if (len < 0 && errno == EINTR) continue;
+            if (len <= 0) return false;
+
+            data += len;
+            size -= static_cast<std::size_t>(len);
+        }
+        return true;
+    }
+
+    // Blocking, used by the client side only
+    bool read_frame(int fd, std::string &frame) {
+        std::uint32_t size;
+        if (!read_all(fd, reinterpret_cast<char*>(&size), sizeof(size))) return false;
+        if (size > max_frame_size) return false;
+
+        frame.resize(size);
+        return read_all(fd, frame.data(), size);
+    }
+
+    // frame must have been started with begin_frame()
+    void end_frame(std::string &frame) {
+        const auto size = gsl::narrow<std::uint32_t>(frame.size() - sizeof(std::uint32_t));
+        std::memcpy(frame.data(), &size, sizeof(size));
+    }
+
+    bool write_frame(int fd, std::string &frame) {
+        end_frame(frame);
+        return write_all(fd, frame.data(), frame.size());
+    }
+
+    sockaddr_un make_address(const std::string &socket_path) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+
+        RUNTIME_MSG_ASSERT(socket_path.size() < sizeof(addr.sun_path), socket_path);
+        std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1u);
+
+        return addr;
+    }
+
+    // The socket lives in a directory only we can enter, so nobody else can bind it first
+    // or swap it out; the checks refuse one someone else made for us.
+    bool is_private_directory(const fs::path &directory) {
+        struct stat st;
+        return lstat(directory.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == geteuid() && (st.st_mode & 077) == 0;
+    }
+
+    // The kernel's word on who is at the other end, checked both ways
+    bool peer_is_us(int fd) {
+        ucred cred{};
+        socklen_t len = sizeof(cred);
+        return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == geteuid();
+    }
+
+    int connect_to(const sockaddr_un &addr) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        RUNTIME_CODE_ASSERT(fd != -1, errno);
+
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // Client sockets are non-blocking, so a client that stalls mid-frame or stops
+    // reading its replies only ever holds up itself
+    struct client_state {
+        std::unique_ptr<federated_engine> engine;
+        std::string input;              // received bytes not yet consumed as requests
+        std::string response;
+        std::string output;             // the reply still being sent
+        std::size_t output_sent = 0u;
+    };
+
+    // Appends whatever the socket has to input; false if the client hung up or errored
+    bool receive(int fd, std::string &input) {
+        char buff[4096];
+
+        while (true) {
+            const auto len = read(fd, buff, sizeof(buff));
+            if (len > 0) {
+                input.append(buff, static_cast<std::size_t>(len));
+                continue;
+            }
+            if (len == 0) return false;
+            if (errno == EINTR) continue;
+
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    // Sends as much of the pending reply as the socket takes; false if the client is gone
+    bool flush(int fd, client_state &client) {
+        while (client.output_sent < client.output.size()) {
+            const auto len = send(fd, client.output.data() + client.output_sent, client.output.size() - client.output_sent,
+                                  MSG_NOSIGNAL);
+            if (len < 0 && errno == EINTR) continue;
+            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            if (len <= 0) return false;
+
+            client.output_sent += static_cast<std::size_t>(len);
+        }
+
+        client.output.clear();
+        client.output_sent = 0u;
+        return true;
+    }
+
+    // Handles one complete request, leaving the finished reply frame in client.response; false drops the client
+    bool answer(std::string_view request, client_state &client, manifest_cache &indexes) {
+        try {
+            frame_reader reader{ request };
+            auto &response = client.response;
+            begin_frame(response);
+
+            const auto op = static_cast<opcode>(reader.get_value<std::uint8_t>());
+            RUNTIME_ASSERT(op == opcode::OPEN || client.engine);
+
+            switch (op) {
+            case opcode::OPEN:
+                {
+                    const auto version = reader.get_value<std::uint8_t>();
+                    RUNTIME_MSG_ASSERT(version == protocol_version, "Client speaks protocol version " + std::to_string(version));
+
+                    const auto matcher_value = reader.get_value<std::uint8_t>();
+                    RUNTIME_ASSERT(matcher_value <= std::uint8_t(matcher_kind::SUBSEQUENCE));
+                    const auto matcher = static_cast<matcher_kind>(matcher_value);
+
+                    std::vector<std::string> filenames;
+                    const auto count = reader.get_value<std::uint32_t>();
+
+                    for (std::uint32_t i = 0u; i < count; ++i) {
+                        filenames.emplace_back(reader.get_string());
+                    }
+
+                    client.engine = std::make_unique<federated_engine>(indexes.open(filenames), matcher);
+                    put_value(response, client.engine->generation());
+                }
+                break;
+
+            case opcode::RANK:
+                {
+                    const auto &ranking = client.engine->rank(reader.get_string());
+
+                    put_value(response, gsl::narrow<std::uint32_t>(ranking.size()));
+                    for (const auto name : ranking) {
+                        put_string(response, name);
+                    }
+                }
+                break;
+
+            case opcode::ADD_NAME:
+                client.engine->add_name(reader.get_string());
+                put_value(response, std::uint8_t(1));
+                break;
+
+            case opcode::REMOVE_NAME:
+                client.engine->remove_name(reader.get_string());
+                put_value(response, std::uint8_t(1));
+                break;
+
+            case opcode::PERSIST:
+                try {
+                    client.engine->persist();
+                    put_value(response, std::uint8_t(1));
+                    put_string(response, {});
+                }
+                catch (const std::exception &err) {
+                    put_value(response, std::uint8_t(0));
+                    put_string(response, err.what());
+                }
+                break;
+
+            case opcode::GENERATION:
+                put_value(response, client.engine->generation());
+                break;
+
+            default:
+                RUNTIME_ERROR("Unknown opcode");
+            }
+        }
+        catch (const std::exception &err) {
+            // A malformed request or a manifest that fails to load costs this client, not the daemon
+            std::cerr << "Error: " << err.what() << '\n';
+            return false;
+        }
+
+        end_frame(client.response);
+        return true;
+    }
+
+    // Answers the complete requests buffered in client.input, one reply in flight at a time;
+    // false drops the client
+    bool serve(int fd, client_state &client, manifest_cache &indexes) {
+        std::size_t consumed = 0u;
+        bool alive = flush(fd, client);
+
+        while (alive && client.output.empty()) {
+            const std::string_view pending{ client.input.data() + consumed, client.input.size() - consumed };
+            if (pending.size() < sizeof(std::uint32_t)) break;
+
+            std::uint32_t size;
+            std::memcpy(&size, pending.data(), sizeof(size));
+            if (size > max_frame_size) {
+                alive = false;
+                break;
+            }
+            if (pending.size() - sizeof(size) < size) break;
+
+            alive = answer(pending.substr(sizeof(size), size), client, indexes);
+            consumed += sizeof(size) + size;
+
+            if (alive) {
+                std::swap(client.output, client.response);
+                alive = flush(fd, client);
+            }
+        }
+
+        client.input.erase(0u, consumed);
+        return alive;
+    }
+
+    void request_stop(int) {
+        stop_requested = 1;
+    }
+
+} // anonymous namespace
+
+std::string daemon_socket_path() {
+    fs::path directory;
+    if (const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR")) {
+        directory = fs::path{ runtime_dir } / "lmkdir";
+    }
+    else {
+        directory = "/tmp/lmkdir-" + std::to_string(geteuid());
+    }
+    return (directory / "lmkdir.sock").string();
+}
+
+void run_daemon(const std::string &socket_path) {
+    const auto addr = make_address(socket_path);
+
+    const auto directory = fs::path{ socket_path }.parent_path();
+    if (mkdir(directory.c_str(), 0700) != 0) {
+        RUNTIME_MSG_ASSERT(errno == EEXIST, directory.string());
+    }
+    RUNTIME_MSG_ASSERT(is_private_directory(directory), directory.string() + " must be a directory owned by us with mode 0700");
+
+    if (int fd = connect_to(addr); fd != -1) {
+        close(fd);
+        RUNTIME_ERROR("A daemon is already listening on " + socket_path);
+    }
+    unlink(socket_path.c_str());
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    RUNTIME_CODE_ASSERT(listen_fd != -1, errno);
+    RUNTIME_MSG_ASSERT(bind(listen_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0, socket_path);
+    RUNTIME_MSG_ASSERT(listen(listen_fd, SOMAXCONN) == 0, socket_path);
+
+    // No SA_RESTART, so a signal interrupts poll() and the loop gets to check the flag
+    struct sigaction action{};
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    manifest_cache indexes;
+    std::unordered_map<int, client_state> clients;
+    std::vector<pollfd> fds;
+
+    while (stop_requested == 0) {
+        fds.clear();
+        fds.push_back({ listen_fd, POLLIN, 0 });
+        for (const auto &[fd, client] : clients) {
+            // Requests stay unread while a reply is pending, so a client that never reads can't pile them up
+            const short events = client.output.empty() ? POLLIN : POLLOUT;
+            fds.push_back({ fd, events, 0 });
+        }
+
+        if (poll(fds.data(), fds.size(), poll_timeout_ms) < 0) {
+            RUNTIME_CODE_ASSERT(errno == EINTR, errno);
+            continue;
+        }
+
+        indexes.sync();
+
+        for (std::size_t i = 1u; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) continue;
+
+            const int fd = fds[i].fd;
+            auto &client = clients[fd];
+
+            const bool readable = (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+            if ((readable && !receive(fd, client.input)) || !serve(fd, client, indexes)) {
+                close(fd);
+                clients.erase(fd);
+            }
+        }
+
+        if ((fds[0].revents & POLLIN) != 0) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (fd != -1 && peer_is_us(fd)) {
+                clients.emplace(fd, client_state{});
+            }
+            else if (fd != -1) {
+                close(fd);
+            }
+        }
+    }
+
+    for (const auto &[fd, client] : clients) {
+        close(fd);
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    indexes.persist();
+}
+
+daemon_client::daemon_client(int fd, engine_factory fallback)
+:m_fd{ fd },
+ m_fallback{ std::move(fallback) }
+{
+    m_request.reserve(1024);
+}
+
+daemon_client::~daemon_client() {
+    if (m_fd != -1) close(m_fd);
+}
+
+std::unique_ptr<daemon_client> daemon_client::connect(const std::string &socket_path, const std::vector<std::string> &manifest_files,
+                                                     matcher_kind matcher, engine_factory fallback)
+{
+    if (!is_private_directory(fs::path{ socket_path }.parent_path())) return nullptr;
+
+    int fd = connect_to(make_address(socket_path));
+    if (fd == -1) return nullptr;
+
+    if (!peer_is_us(fd)) {
+        close(fd);
+        return nullptr;
+    }
+
+    // A wedged daemon turns into a timed-out call and a switch to the fallback, never a frozen UI
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &reply_timeout, sizeof(reply_timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &reply_timeout, sizeof(reply_timeout));
+
+    std::unique_ptr<daemon_client> client{ new daemon_client{ fd, std::move(fallback) } };
+
+    begin_frame(client->m_request);
+    put_value(client->m_request, std::uint8_t(opcode::OPEN));
+    put_value(client->m_request, protocol_version);
+    put_value(client->m_request, std::uint8_t(matcher));
+    put_value(client->m_request, gsl::narrow<std::uint32_t>(manifest_files.size()));
+    for (const auto &filename : manifest_files) {
+        put_string(client->m_request, filename);
+    }
+    if (!write_frame(fd, client->m_request) || !read_frame(fd, client->m_response)) return nullptr;
+
+    client->m_generation = frame_reader{ client->m_response }.get_value<std::uint64_t>();
+    return client;
+}
+
+bool daemon_client::call() {
+    if (write_frame(m_fd, m_request) && read_frame(m_fd, m_response)) return true;
+
+    fall_back();
+    return false;
+}
+
+void daemon_client::fall_back() {
+    close(m_fd);
+    m_fd = -1;
+
+    m_local = m_fallback();
+    for (const auto &[added, name] : m_edits) {
+        if (added) {
+            m_local->add_name(name);
+        }
+        else {
+            m_local->remove_name(name);
+        }
+    }
+    m_edits.clear();
+}
+
+const std::vector<std::string_view> &daemon_client::rank(std::string_view query) {
+    if (m_local) return m_local->rank(query);
+
+    begin_frame(m_request);
+    put_value(m_request, std::uint8_t(opcode::RANK));
+    put_string(m_request, query);
+    if (!call()) return m_local->rank(query);
+
+    frame_reader reader{ m_response };
+    const auto count = reader.get_value<std::uint32_t>();
+
+    m_ranking.clear();
+    for (std::uint32_t i = 0u; i < count; ++i) {
+        m_ranking.emplace_back(reader.get_string());
+    }
+
+    return m_ranking;
+}
+
+// A failed call replays m_edits, this one included, onto the local engine
+void daemon_client::add_name(std::string_view name) {
+    if (m_local) return m_local->add_name(name);
+
+    m_edits.emplace_back(true, name);
+    begin_frame(m_request);
+    put_value(m_request, std::uint8_t(opcode::ADD_NAME));
+    put_string(m_request, name);
+    call();
+}
+
+void daemon_client::remove_name(std::string_view name) {
+    if (m_local) return m_local->remove_name(name);
+
+    m_edits.emplace_back(false, name);
+    begin_frame(m_request);
+    put_value(m_request, std::uint8_t(opcode::REMOVE_NAME));
+    put_string(m_request, name);
+    call();
+}
+
+bool daemon_client::poll() {
+    if (m_local) return m_local->poll();
+
+    begin_frame(m_request);
+    put_value(m_request, std::uint8_t(opcode::GENERATION));
+    if (!call()) return true;
+
+    const auto generation = frame_reader{ m_response }.get_value<std::uint64_t>();
+    return std::exchange(m_generation, generation) != generation;
+}
+
+void daemon_client::persist() {
+    if (m_local) return m_local->persist();
+
+    begin_frame(m_request);
+    put_value(m_request, std::uint8_t(opcode::PERSIST));
+    if (!call()) return m_local->persist();
+
+    frame_reader reader{ m_response };
+    const auto status = reader.get_value<std::uint8_t>();
+    RUNTIME_MSG_ASSERT(status != 0u, reader.get_string());
+}
@@ -0,0 +1,62 @@
+#ifndef LMKDIR_DAEMON_HPP
+#define LMKDIR_DAEMON_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "manifest_federation.hpp"
+
+// lmkdir.sock in $XDG_RUNTIME_DIR/lmkdir, or in a per-user directory in /tmp.
+// The daemon creates the directory 0700 and both ends refuse it otherwise.
+std::string daemon_socket_path();
+
+// Keeps every manifest a client has opened loaded and indexed, serving them over
+// a Unix domain socket. Returns on SIGINT/SIGTERM after persisting them all.
+void run_daemon(const std::string &socket_path);
+
+// Forwards the engine interface to a running daemon. If the daemon goes away or
+// stops answering, the rest of the session runs on an in-process engine instead.
+class daemon_client : public manifest_engine {
+public:
+    using engine_factory = std::function<std::unique_ptr<manifest_engine>()>;
+
+private:
+    int m_fd;
+    engine_factory m_fallback;
+    std::unique_ptr<manifest_engine> m_local;
+    // This session's adds (true) and removes, replayed onto m_local when falling back
+    std::vector<std::pair<bool, std::string>> m_edits;
+    std::string m_request;
+    std::string m_response;
+    std::vector<std::string_view> m_ranking;
+    std::uint64_t m_generation = 0u;
+
+    daemon_client(int fd, engine_factory fallback);
+
+    // Sends m_request and reads the reply into m_response; on failure or timeout
+    // switches to the local engine and returns false
+    bool call();
+    void fall_back();
+
+public:
+    // Returns nullptr if no daemon is listening or it cannot load the manifests
+    static std::unique_ptr<daemon_client> connect(const std::string &socket_path, const std::vector<std::string> &manifest_files,
+                                                  matcher_kind matcher, engine_factory fallback);
+
+    ~daemon_client() override;
+
+    daemon_client(const daemon_client&) = delete;
+    daemon_client &operator=(const daemon_client&) = delete;
+
+    const std::vector<std::string_view> &rank(std::string_view query) override;
+    void add_name(std::string_view name) override;
+    void remove_name(std::string_view name) override;
+    bool poll() override;
+    void persist() override;
+};
+
+#endif // LMKDIR_DAEMON_HPP
@@ -0,0 +1,180 @@
+#include <future>
+
+#include "lmkdir.hpp"
+#include "manifest_federation.hpp"
+
+namespace {
+
+    // One manifest failing to write must not stop the others from being written,
+    // so every index gets its turn before the failures are reported together
+    template <typename Func>
+    void persist_each(std::size_t count, Func &&index_at) {
+        std::string failures;
+
+        for (std::size_t i = 0u; i < count; ++i) {
+            try {
+                index_at(i).persist();
+            }
+            catch (const std::exception &err) {
+                if (!failures.empty()) failures += "; ";
+                failures += err.what();
+            }
+        }
+
+        RUNTIME_MSG_ASSERT(failures.empty(), failures);
+    }
+
+} // anonymous namespace
+
+std::vector<std::shared_ptr<manifest_index>> manifest_cache::open(const std::vector<std::string> &filenames) {
+    // Reading and indexing one manifest is independent of the others, so they load concurrently
+    std::vector<const std::string*> missing;
+    std::vector<std::future<std::shared_ptr<manifest_index>>> pending;
+
+    for (const auto &filename : filenames) {
+        if (m_indexes.count(filename) != 0u) continue;
+        if (std::any_of(missing.begin(), missing.end(), [&filename](const auto other) { return *other == filename; })) continue;
+
+        // Watched before it is read, so an edit landing in between is still seen
+        m_watcher.watch(filename);
+
+        missing.emplace_back(&filename);
+        pending.emplace_back(std::async(std::launch::async, [this, &filename]() {
+            return std::make_shared<manifest_index>(filename, m_watcher);
+        }));
+    }
+
+    // Every load finishes before failures are reported together, as in persist_each
+    std::string failures;
+    for (std::size_t i = 0u; i < pending.size(); ++i) {
+        try {
+            m_indexes.emplace(*missing[i], pending[i].get());
+        }
+        catch (const std::exception &err) {
+            if (!failures.empty()) failures += "; ";
+            failures += err.what();
+        }
+    }
+    RUNTIME_MSG_ASSERT(failures.empty(), failures);
+
+    std::vector<std::shared_ptr<manifest_index>> indexes;
+    indexes.reserve(filenames.size());
+    for (const auto &filename : filenames) {
+        indexes.emplace_back(m_indexes.at(filename));
+    }
+    return indexes;
+}
+
+void manifest_cache::sync() {
+    for (auto &[filename, index] : m_indexes) {
+        index->sync();
+    }
+}
+
+void manifest_cache::persist() {
+    std::vector<manifest_index*> indexes;
+    for (auto &[filename, index] : m_indexes) {
+        indexes.emplace_back(index.get());
+    }
+
+    persist_each(indexes.size(), [&indexes](std::size_t i) -> manifest_index& { return *indexes[i]; });
+}
+
+federated_engine::federated_engine(std::vector<std::shared_ptr<manifest_index>> sources, matcher_kind matcher)
+:m_sources{ std::move(sources) },
+ m_matcher{ matcher }
+{
+    RUNTIME_ASSERT(!m_sources.empty());
+
+    m_scores.resize(m_sources.size());
+    m_heap.reserve(m_sources.size());
+}
+
+const std::vector<std::string_view> &federated_engine::rank(std::string_view query) {
+    // Every index scores into its own buffers, so the sources can be ranked concurrently
+    std::vector<std::future<const std::vector<scored_name>*>> pending;
+    pending.reserve(m_sources.size() - 1u);
+
+    for (std::size_t i = 1u; i < m_sources.size(); ++i) {
+        pending.emplace_back(std::async(std::launch::async, [this, i, query]() { return &m_sources[i]->score(query, m_matcher); }));
+    }
+
+    m_scores[0] = &m_sources[0]->score(query, m_matcher);
+    for (std::size_t i = 1u; i < m_sources.size(); ++i) {
+        m_scores[i] = pending[i - 1u].get();
+    }
+
+    // Stable k-way merge: equal scores keep source order, and each source keeps its own order.
+    // A name held by several sources is listed once, at its best position.
+    auto worse = [](const cursor &lhs, const cursor &rhs) {
+        return lhs.score < rhs.score || (lhs.score == rhs.score && lhs.source > rhs.source);
+    };
+
+    m_heap.clear();
+    for (std::size_t i = 0u; i < m_sources.size(); ++i) {
+        if (!m_scores[i]->empty()) {
+            m_heap.push_back({ m_scores[i]->front().first, i, 0u });
+        }
+    }
+    std::make_heap(m_heap.begin(), m_heap.end(), worse);
+
+    m_ranking.clear();
+    m_seen.clear();
+
+    while (!m_heap.empty()) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), worse);
+        auto &top = m_heap.back();
+        const auto &scores = *m_scores[top.source];
+
+        const auto name = scores[top.position].second;
+        if (m_seen.insert(name).second) {
+            m_ranking.emplace_back(name);
+        }
+
+        if (++top.position < scores.size()) {
+            top.score = scores[top.position].first;
+            std::push_heap(m_heap.begin(), m_heap.end(), worse);
+        }
+        else {
+            m_heap.pop_back();
+        }
+    }
+
+    return m_ranking;
+}
+
+void federated_engine::add_name(std::string_view name) {
+    for (const auto &source : m_sources) {
+        if (source->contains(name)) return;
+    }
+    m_sources[0]->add_name(name);
+}
+
+void federated_engine::remove_name(std::string_view name) {
+    for (const auto &source : m_sources) {
+        if (source->contains(name)) {
+            source->remove_name(name);
+            return;
+        }
+    }
+}
+
+bool federated_engine::poll() {
+    bool changed = false;
+    for (const auto &source : m_sources) {
+        changed |= source->poll();
+    }
+    return changed;
+}
+
+void federated_engine::persist() {
+    persist_each(m_sources.size(), [this](std::size_t i) -> manifest_index& { return *m_sources[i]; });
+}
+
+std::uint64_t federated_engine::generation() const noexcept {
+    std::uint64_t generation = 0u;
+    for (const auto &source : m_sources) {
+        generation += source->generation();
+    }
+    return generation;
+}
@@ -0,0 +1,63 @@
+#ifndef MANIFEST_FEDERATION_HPP
+#define MANIFEST_FEDERATION_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "manifest_index.hpp"
+
+// Hands out one manifest_index per file, so a manifest shared by several
+// federations (typically the site-wide one) is loaded and indexed once
+class manifest_cache {
+    manifest_watcher m_watcher;
+    std::unordered_map<std::string, std::shared_ptr<manifest_index>> m_indexes;
+
+public:
+    // One index per filename, in order. Filenames must already be canonical, and
+    // the indexes must not outlive the cache. Manifests not yet cached are loaded
+    // concurrently; if any fails, none of the failed ones are cached.
+    std::vector<std::shared_ptr<manifest_index>> open(const std::vector<std::string> &filenames);
+
+    void sync();
+    void persist();
+};
+
+// Searches several manifests as one, nearest first. New names are written to
+// the first source; a removal goes only to the nearest source that holds the
+// name, so deleting a directory never edits a shared manifest further out.
+class federated_engine : public manifest_engine {
+    struct cursor {
+        std::int64_t score;
+        std::size_t source;
+        std::size_t position;
+    };
+
+    std::vector<std::shared_ptr<manifest_index>> m_sources;
+    matcher_kind m_matcher;
+    std::vector<const std::vector<scored_name>*> m_scores;
+    std::vector<cursor> m_heap;
+    std::unordered_set<std::string_view> m_seen;
+    std::vector<std::string_view> m_ranking;
+
+public:
+    federated_engine(std::vector<std::shared_ptr<manifest_index>> sources, matcher_kind matcher);
+
+    federated_engine(const federated_engine&) = delete;
+    federated_engine &operator=(const federated_engine&) = delete;
+
+    const std::vector<std::string_view> &rank(std::string_view query) override;
+    void add_name(std::string_view name) override;
+    void remove_name(std::string_view name) override;
+    bool poll() override;
+    void persist() override;
+
+    // Sum of the sources' generations, which moves whenever any of them changes
+    std::uint64_t generation() const noexcept;
+};
+
+#endif // MANIFEST_FEDERATION_HPP
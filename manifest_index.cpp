@@ -0,0 +1,290 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lmkdir.hpp"
+#include "manifest_index.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    // Exclusive flock on <manifest>.lock. The manifest itself is replaced by rename,
+    // so a lock on its inode would not be seen by anyone who opens it afterwards.
+    // The lock file is left in place. flock needs no write access, so it is opened
+    // read-only: a lock file created by one user under their umask still serves
+    // everyone else who shares the manifest.
+    class manifest_lock {
+        int m_fd;
+
+    public:
+        explicit manifest_lock(const std::string &filename) {
+            const auto lock_filename = filename + ".lock";
+
+            m_fd = open(lock_filename.c_str(), O_RDONLY | O_CREAT | O_CLOEXEC, 0644);
+            RUNTIME_MSG_ASSERT(m_fd != -1, lock_filename);
+
+            int res;
+            do {
+                res = flock(m_fd, LOCK_EX);
+            } while (res != 0 && errno == EINTR);
+
+            if (res != 0) close(m_fd);
+            RUNTIME_MSG_ASSERT(res == 0, lock_filename);
+        }
+
+        ~manifest_lock() {
+            close(m_fd);
+        }
+
+        manifest_lock(const manifest_lock&) = delete;
+        manifest_lock &operator=(const manifest_lock&) = delete;
+    };
+
+    std::string_view strip(std::string_view str) {
+        auto offset = str.find_first_not_of(" \t");
+        if (offset != std::string_view::npos) {
+            str = str.substr(offset);
+        }
+
+        offset = str.find_last_not_of(" \t/");
+        if (offset != std::string_view::npos) {
+            str = str.substr(0, offset + 1);
+        }
+
+        return str;
+    }
+
+    directory_manifest sorted_names(const manifest_names &names) {
+        directory_manifest manifest;
+        manifest.reserve(names.size());
+
+        for (const auto &[str, name] : names) {
+            manifest.emplace_back(str);
+        }
+        std::sort(manifest.begin(), manifest.end());
+
+        return manifest;
+    }
+
+    folded_name fold_name(std::string_view str) {
+        folded_name name{ is_ascii(str), {} };
+        if (!name.ascii) {
+            utf8_decode_folded(str, name.code_points);
+        }
+        return name;
+    }
+
+} // anonymous namespace
+
+directory_manifest read_directory_manifest(const std::string_view filename) {
+    std::string contents;
+
+    {
+        std::ifstream fs{ filename.data(), std::ios_base::binary | std::ios_base::ate };
+        RUNTIME_MSG_ASSERT(fs, filename);
+
+        const auto filesize = fs.tellg();
+        contents.resize(gsl::narrow<std::size_t>(filesize));
+
+        fs.seekg(0);
+        RUNTIME_MSG_ASSERT(fs, filename);
+
+        fs.read(contents.data(), filesize);
+        RUNTIME_MSG_ASSERT(fs, filename);
+    }
+
+    auto range_of_names = contents
+                          | boost::adaptors::tokenized(boost::regex("[^\\r\\n]+"))
+                          | boost::adaptors::transformed([](auto &rng) { return std::string_view{ &*rng.begin(), gsl::narrow<std::size_t>(rng.end() - rng.begin()) }; })
+                          | boost::adaptors::transformed(strip);
+
+    directory_manifest manifest{ range_of_names.begin(), range_of_names.end() };
+    std::sort(manifest.begin(), manifest.end());
+
+    auto new_end = std::unique(manifest.begin(), manifest.end());
+    manifest.erase(new_end, manifest.end());
+
+    return manifest;
+}
+
+void write_directory_manifest(const std::string_view filename, const manifest_names &names) {
+    // A unique temporary next to the manifest, so concurrent writers never share one
+    // and the final rename stays within a filesystem
+    auto tmp_filename = std::string{ filename } + ".XXXXXX";
+    {
+        const int fd = mkstemp(tmp_filename.data());
+        RUNTIME_MSG_ASSERT(fd != -1, tmp_filename);
+
+        // mkstemp creates the file 0600; keep the manifest readable by whoever could read it before
+        struct stat st;
+        const mode_t mode = stat(std::string{ filename }.c_str(), &st) == 0 ? (st.st_mode & 07777) : 0644;
+        const bool mode_ok = fchmod(fd, mode) == 0;
+        close(fd);
+
+        if (!mode_ok) unlink(tmp_filename.c_str());
+        RUNTIME_MSG_ASSERT(mode_ok, tmp_filename);
+
+        try {
+            std::vector<std::string_view> man;
+            man.reserve(names.size());
+
+            for (const auto &[str, name] : names) {
+                man.emplace_back(str);
+            }
+            std::sort(man.begin(), man.end());
+    
+            std::ofstream fs{ tmp_filename.data(), std::ios_base::binary };
+            RUNTIME_MSG_ASSERT(fs, tmp_filename);
+    
+            for (const auto &name : man) {
+                fs << name << "\n";
+                RUNTIME_MSG_ASSERT(fs, tmp_filename);
+            }
+    
+            fs.flush();
+            RUNTIME_MSG_ASSERT(fs, tmp_filename);
+        } catch (...) {
+            unlink(tmp_filename.c_str());
+            throw;
+        }
+    }
+    
+    std::error_code err;
+    fs::rename(tmp_filename, filename, err);
+    if (err) unlink(tmp_filename.c_str());
+    RUNTIME_MSG_ASSERT(!err, filename);
+}
+
+manifest_index::manifest_index(std::string filename, manifest_watcher &watcher)
+:m_filename{ std::move(filename) },
+ m_baseline{ read_directory_manifest(m_filename) },
+ m_watcher{ watcher }
+{
+    m_names.reserve(m_baseline.size());
+    for (const auto &str : m_baseline) {
+        m_names.emplace(str, fold_name(str));
+    }
+
+    m_scores.reserve(m_names.size());
+    m_levenshtein_buffer.reserve(1024);
+    m_levenshtein_bitset.reserve(128);
+}
+
+// Applies the changes made to the file since m_baseline was read, leaving
+// local additions and removals intact. m_baseline becomes the new on-disk state.
+void manifest_index::merge(directory_manifest &&on_disk) {
+    directory_manifest removed;
+    std::set_difference(m_baseline.begin(), m_baseline.end(), on_disk.begin(), on_disk.end(), std::back_inserter(removed));
+
+    directory_manifest added;
+    std::set_difference(on_disk.begin(), on_disk.end(), m_baseline.begin(), m_baseline.end(), std::back_inserter(added));
+
+    for (const auto &name : removed) {
+        erase(name);
+    }
+    for (const auto &name : added) {
+        insert(name);
+    }
+
+    m_baseline = std::move(on_disk);
+}
+
+const std::vector<scored_name> &manifest_index::score(std::string_view query, matcher_kind matcher) {
+    m_scores.clear();
+
+    if (query.empty()) {
+        for (const auto &[str, name] : m_names) {
+            m_scores.emplace_back(0, str);
+        }
+        return m_scores;
+    }
+
+    m_folded_query.clear();
+    utf8_decode_folded(query, m_folded_query);
+    const bool ascii_query = is_ascii(query);
+
+    // Only pairs of ASCII strings take the byte kernel. A non-ASCII query still has to
+    // score ASCII names, which keep their widened form from the first such query on.
+    auto score_name = [&](const auto &match_bytes, const auto &match_code_points, const std::string &str, folded_name &name) {
+        if (name.ascii && ascii_query) return match_bytes(str);
+
+        if (name.ascii && name.code_points.size() != str.size()) {
+            name.code_points.resize(str.size());
+            std::transform(str.begin(), str.end(), name.code_points.begin(),
+                           [](char c) { return fold_case(static_cast<unsigned char>(c)); });
+        }
+        return match_code_points(name.code_points);
+    };
+
+    with_matcher<false>(matcher, query, m_folded_query, m_levenshtein_buffer, m_levenshtein_bitset,
+                        [&](const auto &match_bytes, const auto &match_code_points) {
+        for (auto &[str, name] : m_names) {
+            if (auto score = score_name(match_bytes, match_code_points, str, name)) {
+                m_scores.emplace_back(*score, str);
+            }
+        }
+    });
+
+    std::stable_sort(m_scores.begin(), m_scores.end(), 
+                     [](const auto &lhs, const auto &rhs){ return lhs.first > rhs.first; });
+
+    return m_scores;
+}
+
+void manifest_index::insert(std::string_view name) {
+    if (m_names.emplace(name, fold_name(name)).second) {
+        ++m_generation;
+    }
+}
+
+void manifest_index::erase(std::string_view name) {
+    if (m_names.erase(std::string{ name }) != 0u) {
+        ++m_generation;
+    }
+}
+
+void manifest_index::add_name(std::string_view name) {
+    insert(name);
+    m_dirty = true;
+}
+
+void manifest_index::remove_name(std::string_view name) {
+    erase(name);
+    m_dirty = true;
+}
+
+bool manifest_index::poll() {
+    sync();
+    return std::exchange(m_polled_generation, m_generation) != m_generation;
+}
+
+void manifest_index::sync() {
+    if (!m_watcher.poll(m_filename)) return;
+
+    // A manifest caught mid-write or made unreadable is skipped; the next change or persist() catches up
+    try {
+        if (fs::exists(m_filename)) {
+            merge(read_directory_manifest(m_filename));
+        }
+    } catch (const std::exception&) {
+    }
+}
+
+void manifest_index::persist() {
+    // Shared manifests may well be read-only for us, so leave untouched ones alone
+    if (!m_dirty) return;
+
+    // Other instances merge and write under the same lock, so none of their edits slip in between
+    manifest_lock lock{ m_filename };
+
+    // Pick up edits made by others that haven't been seen yet, rather than clobbering them
+    if (fs::exists(m_filename)) {
+        merge(read_directory_manifest(m_filename));
+    }
+    write_directory_manifest(m_filename, m_names);
+
+    m_baseline = sorted_names(m_names);
+    m_dirty = false;
+}
@@ -0,0 +1,103 @@
+#ifndef MANIFEST_INDEX_HPP
+#define MANIFEST_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "manifest_watcher.hpp"
+#include "matchers.hpp"
+
+// A name decoded to case-folded code points once, when it enters the index.
+// Pure-ASCII names are matched byte-wise and only get code points, widened
+// through the fold table, the first time a non-ASCII query has to score them.
+struct folded_name {
+    bool ascii;
+    std::u32string code_points;
+};
+
+using directory_manifest = std::vector<std::string>;
+using manifest_names = std::unordered_map<std::string, folded_name>;
+using scored_name = std::pair<std::int64_t, std::string_view>;
+
+directory_manifest read_directory_manifest(std::string_view filename);
+void write_directory_manifest(std::string_view filename, const manifest_names &names);
+
+// What the menu ranks against and writes back to, either in-process or through the daemon
+class manifest_engine {
+public:
+    virtual ~manifest_engine() = default;
+
+    // Names ranked against query, best first; an empty query lists every name.
+    // The views are valid until the next call on the engine.
+    virtual const std::vector<std::string_view> &rank(std::string_view query) = 0;
+
+    virtual void add_name(std::string_view name) = 0;
+    virtual void remove_name(std::string_view name) = 0;
+
+    // Returns true if the names changed since the last call
+    virtual bool poll() = 0;
+
+    // Merges outside edits and writes the manifest back
+    virtual void persist() = 0;
+};
+
+// A single manifest file: its names, their folded forms and the buffers to score them.
+// Ranking for the menu goes through federated_engine, which merges one or more of these.
+class manifest_index {
+    std::string m_filename;
+    directory_manifest m_baseline;
+    manifest_names m_names;
+    manifest_watcher &m_watcher;
+    std::uint64_t m_generation = 0u;
+    std::uint64_t m_polled_generation = 0u;
+    bool m_dirty = false;
+
+    std::vector<scored_name> m_scores;
+    std::vector<std::int64_t> m_levenshtein_buffer;
+    std::vector<std::byte> m_levenshtein_bitset;
+    std::u32string m_folded_query;
+
+    void insert(std::string_view name);
+    void erase(std::string_view name);
+    void merge(directory_manifest &&on_disk);
+
+public:
+    // watcher is shared with the other indexes and must outlive this one
+    manifest_index(std::string filename, manifest_watcher &watcher);
+
+    manifest_index(const manifest_index&) = delete;
+    manifest_index &operator=(const manifest_index&) = delete;
+
+    // Names paired with their score against query, best first. An empty query
+    // scores every name 0. Scores count code points rather than bytes.
+    // Valid until the next call that touches this index.
+    const std::vector<scored_name> &score(std::string_view query, matcher_kind matcher);
+
+    void add_name(std::string_view name);
+    void remove_name(std::string_view name);
+
+    // Returns true if the names changed since the last call
+    bool poll();
+
+    // Writes the manifest back only if names were added or removed through this index
+    void persist();
+
+    inline bool contains(std::string_view name) const {
+        return m_names.count(std::string{ name }) != 0u;
+    }
+
+    // Applies edits made to the file by others, if the watcher saw any. Best-effort: a failed read is skipped
+    void sync();
+
+    // Bumped whenever the set of names changes
+    inline std::uint64_t generation() const noexcept {
+        return m_generation;
+    }
+};
+
+#endif // MANIFEST_INDEX_HPP
@@ -0,0 +1,65 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "manifest_watcher.hpp"
+
+namespace fs = std::filesystem;
+
+manifest_watcher::manifest_watcher() {
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd == -1) {
+        std::cerr << "Warning: manifests will not reload live: " << std::strerror(errno) << '\n';
+    }
+}
+
+manifest_watcher::~manifest_watcher() {
+    if (m_fd != -1) close(m_fd);
+}
+
+bool manifest_watcher::watch(const fs::path &manifest_file) {
+    if (m_fd == -1) return false;
+
+    auto directory = manifest_file.parent_path();
+    if (directory.empty()) directory = ".";
+
+    // Watching a directory again hands back its existing descriptor
+    const int wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd == -1) {
+        std::cerr << "Warning: " << manifest_file.string() << " will not reload live: " << std::strerror(errno) << '\n';
+        return false;
+    }
+
+    m_directories.emplace(wd, std::move(directory));
+    m_watched.emplace(manifest_file.string());
+    return true;
+}
+
+bool manifest_watcher::poll(const std::string &manifest_file) {
+    if (m_fd == -1) return false;
+
+    alignas(inotify_event) char buff[4096];
+
+    while (true) {
+        const ssize_t len = read(m_fd, buff, sizeof(buff));
+        if (len <= 0) break;
+
+        for (ssize_t offset = 0; offset < len;) {
+            const auto event = reinterpret_cast<const inotify_event*>(buff + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            const auto directory = m_directories.find(event->wd);
+            if (event->len == 0u || directory == m_directories.end()) continue;
+
+            auto filename = (directory->second / event->name).string();
+            if (m_watched.count(filename) != 0u) {
+                m_changed.emplace(std::move(filename));
+            }
+        }
+    }
+
+    return m_changed.erase(manifest_file) != 0u;
+}
@@ -0,0 +1,36 @@
+#ifndef MANIFEST_WATCHER_HPP
+#define MANIFEST_WATCHER_HPP
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// One inotify instance for every manifest a process has loaded, with a watch per
+// directory rather than an instance per manifest, since instances are a scarce
+// per-user resource. Watching the directory catches both in-place writes and the
+// rename-over-temporary used by write_directory_manifest.
+// If inotify is unavailable, the affected manifests lose live reload: a warning
+// goes to stderr and poll() never fires for them.
+class manifest_watcher {
+    int m_fd = -1;
+    std::unordered_map<int, std::filesystem::path> m_directories;
+    std::unordered_set<std::string> m_watched;
+    std::unordered_set<std::string> m_changed;
+
+public:
+    manifest_watcher();
+    ~manifest_watcher();
+
+    manifest_watcher(const manifest_watcher&) = delete;
+    manifest_watcher &operator=(const manifest_watcher&) = delete;
+
+    // manifest_file must be canonical. Returns false if it can't be watched.
+    bool watch(const std::filesystem::path &manifest_file);
+
+    // Drains pending events; returns true if manifest_file was replaced or rewritten
+    // since the last call for it
+    bool poll(const std::string &manifest_file);
+};
+
+#endif // MANIFEST_WATCHER_HPP
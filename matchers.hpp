@@ -0,0 +1,187 @@
+#ifndef MATCHERS_HPP
+#define MATCHERS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "levenshtein.hpp"
+
+// Each matcher is built once per query and then called for every candidate,
+// returning its score or nullopt to leave the candidate out of the results.
+// Higher scores rank first.
+
+enum class matcher_kind : std::uint8_t {
+    SUBSTRING,
+    LEVENSHTEIN,
+    SELLERS,
+    SUBSEQUENCE
+};
+
+inline std::optional<matcher_kind> parse_matcher_kind(std::string_view name) noexcept {
+    if (name == "substring") return matcher_kind::SUBSTRING;
+    if (name == "levenshtein") return matcher_kind::LEVENSHTEIN;
+    if (name == "sellers") return matcher_kind::SELLERS;
+    if (name == "subsequence") return matcher_kind::SUBSEQUENCE;
+    return std::nullopt;
+}
+
+namespace DETAIL {
+
+    template <bool CaseSensitive, typename CharType>
+    inline bool char_eq(CharType lhs, CharType rhs) noexcept {
+        return CaseSensitive ? (lhs == rhs) : char_ieq(lhs, rhs);
+    }
+
+    template <bool CaseSensitive, typename CharType>
+    inline bool contains(std::basic_string_view<CharType> str, std::basic_string_view<CharType> query) noexcept {
+        return std::search(str.begin(), str.end(), query.begin(), query.end(), char_eq<CaseSensitive, CharType>) != str.end();
+    }
+
+    template <typename CharType>
+    inline bool is_word_boundary(CharType c) noexcept {
+        return c == CharType('_') || c == CharType('-') || c == CharType(' ') || c == CharType('.') || c == CharType('/');
+    }
+
+} // namespace DETAIL
+
+struct SUBSEQUENCE_SCORE_TABLE {
+    static constexpr std::int64_t match = 16;
+    static constexpr std::int64_t gap_start = -3;
+    static constexpr std::int64_t gap_extension = -1;
+
+    static constexpr std::int64_t first_match_bonus = 16;
+    static constexpr std::int64_t boundary_bonus = 8;
+    static constexpr std::int64_t consecutive_match = 4;
+};
+
+// Keeps names containing the query, in their existing order
+template <typename CharType, bool CaseSensitive>
+class substring_matcher {
+    std::basic_string_view<CharType> m_query;
+
+public:
+    explicit substring_matcher(std::basic_string_view<CharType> query)
+    :m_query{ query }
+    {}
+
+    inline std::optional<std::int64_t> operator()(std::basic_string_view<CharType> name) const noexcept {
+        if (!DETAIL::contains<CaseSensitive>(name, m_query)) return std::nullopt;
+        return 0;
+    }
+};
+
+// Keeps every name: substring matches first, the rest by modified Levenshtein (or Sellers) score.
+// The buffers may be shared between matchers; they are only ever grown.
+template <typename CharType, bool CaseSensitive, typename ScoreTable = LEVENSHTEIN_SCORE_TABLE, bool Sellers = false>
+class levenshtein_matcher {
+    std::basic_string_view<CharType> m_query;
+    std::vector<std::int64_t> &m_buffer;
+    std::vector<std::byte> &m_bitset;
+
+public:
+    levenshtein_matcher(std::basic_string_view<CharType> query, std::vector<std::int64_t> &buffer, std::vector<std::byte> &bitset)
+    :m_query{ query },
+     m_buffer{ buffer },
+     m_bitset{ bitset }
+    {
+        m_buffer.resize(std::max(m_buffer.size(), query.size() + 1));
+        m_bitset.resize(std::max(m_bitset.size(), (query.size() + CHAR_BIT - 1) / CHAR_BIT));
+    }
+
+    inline std::optional<std::int64_t> operator()(std::basic_string_view<CharType> name) const {
+        if (DETAIL::contains<CaseSensitive>(name, m_query)) {
+            return std::numeric_limits<std::int64_t>::max();
+        }
+        return modified_levenshtein_distance<CharType, CaseSensitive, ScoreTable, Sellers>(m_query, name, m_buffer, m_bitset);
+    }
+};
+
+// fzf-style: keeps names containing the query as a subsequence. The first match found
+// scanning forward is tightened by scanning back from its end, then the alignment is
+// scored with bonuses for word boundaries and runs, and penalties for gaps.
+template <typename CharType, bool CaseSensitive, typename ScoreTable = SUBSEQUENCE_SCORE_TABLE>
+class subsequence_matcher {
+    std::basic_string_view<CharType> m_query;
+
+public:
+    explicit subsequence_matcher(std::basic_string_view<CharType> query)
+    :m_query{ query }
+    {}
+
+    std::optional<std::int64_t> operator()(std::basic_string_view<CharType> name) const noexcept {
+        std::size_t end = 0u;
+        for (std::size_t j = 0u; j < m_query.size(); ++end) {
+            if (end == name.size()) return std::nullopt;
+            if (DETAIL::char_eq<CaseSensitive>(name[end], m_query[j])) ++j;
+        }
+
+        std::size_t begin = end;
+        for (std::size_t j = m_query.size(); j > 0u;) {
+            --begin;
+            if (DETAIL::char_eq<CaseSensitive>(name[begin], m_query[j - 1u])) --j;
+        }
+
+        std::int64_t score = 0;
+        std::int64_t run_bonus = 0;
+        bool in_gap = false;
+        bool prev_matched = false;
+
+        for (std::size_t i = begin, j = 0u; i < end; ++i) {
+            if (j < m_query.size() && DETAIL::char_eq<CaseSensitive>(name[i], m_query[j])) {
+                std::int64_t bonus = 0;
+                if (i == 0u) bonus = ScoreTable::first_match_bonus;
+                else if (DETAIL::is_word_boundary(name[i - 1u])) bonus = ScoreTable::boundary_bonus;
+
+                // A run carries the bonus of the character that started it
+                if (prev_matched) bonus = std::max({ bonus, run_bonus, ScoreTable::consecutive_match });
+                else run_bonus = bonus;
+
+                score += ScoreTable::match + bonus;
+
+                ++j;
+                in_gap = false;
+                prev_matched = true;
+            }
+            else {
+                score += in_gap ? ScoreTable::gap_extension : ScoreTable::gap_start;
+                in_gap = true;
+                prev_matched = false;
+            }
+        }
+
+        return score;
+    }
+};
+
+// Builds the matchers for kind and hands them to func, so callers pay for the dispatch
+// once per query and their per-candidate loop is compiled against the concrete matchers.
+// func gets a byte matcher for query and a code point matcher for code_points, which
+// is compared exactly and so must already be folded for a case-insensitive search.
+template <bool CaseSensitive, typename Func>
+decltype(auto) with_matcher(matcher_kind kind, std::string_view query, std::u32string_view code_points,
+                            std::vector<std::int64_t> &levenshtein_buffer, std::vector<std::byte> &levenshtein_bitset,
+                            Func &&func)
+{
+    switch (kind) {
+    case matcher_kind::SUBSTRING:
+        return func(substring_matcher<char, CaseSensitive>{ query },
+                    substring_matcher<char32_t, true>{ code_points });
+    case matcher_kind::SELLERS:
+        return func(levenshtein_matcher<char, CaseSensitive, LEVENSHTEIN_SCORE_TABLE, true>{ query, levenshtein_buffer, levenshtein_bitset },
+                    levenshtein_matcher<char32_t, true, LEVENSHTEIN_SCORE_TABLE, true>{ code_points, levenshtein_buffer, levenshtein_bitset });
+    case matcher_kind::SUBSEQUENCE:
+        return func(subsequence_matcher<char, CaseSensitive>{ query },
+                    subsequence_matcher<char32_t, true>{ code_points });
+    case matcher_kind::LEVENSHTEIN:
+    default:
+        return func(levenshtein_matcher<char, CaseSensitive>{ query, levenshtein_buffer, levenshtein_bitset },
+                    levenshtein_matcher<char32_t, true>{ code_points, levenshtein_buffer, levenshtein_bitset });
+    }
+}
+
+#endif // MATCHERS_HPP
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "metadata_service.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    constexpr unsigned max_workers = 4u;
+    constexpr int max_walk_depth = 4;
+    constexpr std::size_t max_walk_entries = 20000u;
+
+    entry_metadata stat_entry(const std::string &name) {
+        entry_metadata metadata;
+
+        struct statx stx;
+        if (statx(AT_FDCWD, name.c_str(), AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_MTIME | STATX_SIZE, &stx) != 0) {
+            return metadata;
+        }
+
+        metadata.exists = true;
+        metadata.is_directory = S_ISDIR(stx.stx_mode);
+        metadata.mtime = stx.stx_mtime.tv_sec;
+
+        if (!metadata.is_directory) {
+            metadata.size = stx.stx_size;
+        }
+
+        return metadata;
+    }
+
+} // anonymous namespace
+
+metadata_service::metadata_service() {
+    const auto num_workers = std::clamp(std::thread::hardware_concurrency(), 1u, max_workers);
+
+    for (unsigned i = 0u; i < num_workers; ++i) {
+        m_workers.emplace_back(&metadata_service::work, this);
+    }
+}
+
+metadata_service::~metadata_service() {
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        m_stop = true;
+    }
+    m_cv.notify_all();
+
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+void metadata_service::request(std::vector<metadata_request> &requests, bool urgent) {
+    if (requests.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+
+        const auto pos = urgent ? m_queue.begin() : m_queue.end();
+        m_queue.insert(pos, std::make_move_iterator(requests.begin()), std::make_move_iterator(requests.end()));
+    }
+    m_cv.notify_all();
+
+    requests.clear();
+}
+
+void metadata_service::drain(std::vector<metadata_result> &results) {
+    results.clear();
+
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    std::swap(results, m_results);
+}
+
+void metadata_service::publish(const std::string &name, std::uint64_t ticket, const entry_metadata &metadata) {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_results.push_back({ name, ticket, metadata });
+}
+
+void metadata_service::work() {
+    while (true) {
+        metadata_request request;
+
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_cv.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            if (m_stop) return;
+
+            request = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        const auto &[name, ticket] = request;
+
+        auto metadata = stat_entry(name);
+        publish(name, ticket, metadata);
+
+        if (metadata.is_directory) {
+            metadata.size = walk(name, metadata.size_truncated);
+            publish(name, ticket, metadata);
+        }
+    }
+}
+
+// Sums regular file sizes under root, giving up below max_walk_depth or after
+// max_walk_entries so one huge tree can't hold a worker for long
+std::uint64_t metadata_service::walk(const std::string &root, bool &truncated) const {
+    std::uint64_t size = 0u;
+    std::size_t visited = 0u;
+
+    std::error_code err;
+    for (fs::recursive_directory_iterator iter{ root, fs::directory_options::skip_permission_denied, err }, end;
+         !err && iter != end && !m_stop; iter.increment(err))
+    {
+        if (++visited > max_walk_entries) {
+            truncated = true;
+            break;
+        }
+
+        // Links are neither followed nor counted, like du; the iterator doesn't descend into
+        // them either, so a linked directory is never a reason to report truncation
+        std::error_code entry_err;
+        const auto status = iter->symlink_status(entry_err);
+        if (entry_err) continue;
+
+        if (fs::is_directory(status) && iter.depth() + 1 >= max_walk_depth) {
+            iter.disable_recursion_pending();
+            truncated = true;
+        }
+        else if (fs::is_regular_file(status)) {
+            const auto file_size = iter->file_size(entry_err);
+            if (!entry_err) size += file_size;
+        }
+    }
+
+    return size;
+}
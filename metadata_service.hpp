@@ -0,0 +1,61 @@
+#ifndef METADATA_SERVICE_HPP
+#define METADATA_SERVICE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct entry_metadata {
+    bool exists = false;
+    bool is_directory = false;
+    std::int64_t mtime = 0;             // Seconds since the epoch
+    std::optional<std::uint64_t> size;  // Unset until a directory's tree walk finishes
+    bool size_truncated = false;        // The walk ran into its depth or entry budget
+};
+
+using metadata_request = std::pair<std::string, std::uint64_t>;
+
+struct metadata_result {
+    std::string name;
+    std::uint64_t ticket;
+    entry_metadata metadata;
+};
+
+// Stats names relative to the CWD on a pool of worker threads. Each request is
+// answered once with the statx() result and, for directories, again once the
+// bounded walk has summed up the tree underneath.
+class metadata_service {
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<metadata_request> m_queue;
+    std::vector<metadata_result> m_results;
+    std::vector<std::thread> m_workers;
+    std::atomic<bool> m_stop{ false };
+
+    void work();
+    void publish(const std::string &name, std::uint64_t ticket, const entry_metadata &metadata);
+    std::uint64_t walk(const std::string &root, bool &truncated) const;
+
+public:
+    metadata_service();
+    ~metadata_service();
+
+    metadata_service(const metadata_service&) = delete;
+    metadata_service &operator=(const metadata_service&) = delete;
+
+    // Queues (name, ticket) pairs, whose tickets are handed back with the results. Urgent
+    // requests jump the queue in the order given. Leaves requests empty.
+    void request(std::vector<metadata_request> &requests, bool urgent);
+
+    // Moves whatever has completed into results, replacing its contents
+    void drain(std::vector<metadata_result> &results);
+};
+
+#endif // METADATA_SERVICE_HPP
@@ -0,0 +1,192 @@
+#ifndef UTF8_HPP
+#define UTF8_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
+namespace DETAIL {
+
+    constexpr char32_t fold_table_size = 0x800;
+
+    // Simple case folding for U+0000..U+07FF: Latin, Greek, Cyrillic and Armenian
+    constexpr std::array<char32_t, fold_table_size> make_fold_table() {
+        std::array<char32_t, fold_table_size> table{};
+        for (char32_t c = 0; c < fold_table_size; ++c) table[c] = c;
+
+        auto shift = [&table](char32_t first, char32_t last, char32_t offset) {
+            for (char32_t c = first; c <= last; ++c) table[c] = c + offset;
+        };
+        // Alternating upper/lower pairs, uppercase on the parity of first
+        auto pairs = [&table](char32_t first, char32_t last) {
+            for (char32_t c = first; c < last; c += 2) table[c] = c + 1;
+        };
+
+        shift(U'A', U'Z', 0x20);
+        shift(0xC0, 0xD6, 0x20);
+        shift(0xD8, 0xDE, 0x20);
+
+        pairs(0x100, 0x12F);
+        table[0x130] = U'i';
+        pairs(0x132, 0x137);
+        pairs(0x139, 0x148);
+        pairs(0x14A, 0x177);
+        table[0x178] = 0xFF;
+        pairs(0x179, 0x17E);
+        table[0x17F] = U's';
+        pairs(0x1CD, 0x1DC);
+        pairs(0x1DE, 0x1EF);
+        pairs(0x1F8, 0x21F);
+        pairs(0x222, 0x233);
+
+        table[0x386] = 0x3AC;
+        shift(0x388, 0x38A, 0x25);
+        table[0x38C] = 0x3CC;
+        shift(0x38E, 0x38F, 0x3F);
+        shift(0x391, 0x3A1, 0x20);
+        shift(0x3A3, 0x3AB, 0x20);
+        table[0x3C2] = 0x3C3;
+
+        shift(0x400, 0x40F, 0x50);
+        shift(0x410, 0x42F, 0x20);
+        pairs(0x460, 0x481);
+        pairs(0x48A, 0x4BF);
+        table[0x4C0] = 0x4CF;
+        pairs(0x4C1, 0x4CE);
+        pairs(0x4D0, 0x52F);
+
+        shift(0x531, 0x556, 0x30);
+
+        return table;
+    }
+
+    inline constexpr auto fold_table = make_fold_table();
+
+} // namespace DETAIL
+
+inline char32_t fold_case(char32_t c) noexcept {
+    if (c < DETAIL::fold_table_size) return DETAIL::fold_table[c];
+
+    // Latin Extended Additional and fullwidth ASCII, the rest is left alone
+    if ((c >= 0x1E00 && c <= 0x1E95) || (c >= 0x1EA0 && c <= 0x1EFF)) return c | 1u;
+    if (c >= 0xFF21 && c <= 0xFF3A) return c + 0x20;
+    return c;
+}
+
+inline bool is_ascii(std::string_view str) noexcept {
+    const char* data = str.data();
+    std::size_t size = str.size();
+
+#if defined(__SSE2__)
+    for (; size >= 16u; data += 16, size -= 16u) {
+        const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        if (_mm_movemask_epi8(chunk) != 0) return false;
+    }
+#endif
+
+    for (; size >= 8u; data += 8, size -= 8u) {
+        std::uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        if ((word & 0x8080808080808080u) != 0u) return false;
+    }
+
+    for (; size != 0u; ++data, --size) {
+        if (static_cast<unsigned char>(*data) >= 0x80u) return false;
+    }
+
+    return true;
+}
+
+// Length of the last sequence if str stops partway through it, else 0
+inline std::size_t utf8_incomplete_tail(std::string_view str) noexcept {
+    for (std::size_t n = 1u; n <= std::min<std::size_t>(str.size(), 3u); ++n) {
+        const auto c = static_cast<unsigned char>(str[str.size() - n]);
+        if ((c & 0xC0u) == 0x80u) continue;
+
+        const std::size_t expected = c >= 0xF0u ? 4u : c >= 0xE0u ? 3u : c >= 0xC0u ? 2u : 1u;
+        return expected > n ? n : 0u;
+    }
+    return 0u;
+}
+
+// Appends the code points of str to out, folded. Malformed sequences become U+FFFD.
+inline void utf8_decode_folded(std::string_view str, std::u32string &out) {
+    const auto size = str.size();
+
+    for (std::size_t i = 0u; i < size;) {
+        const auto lead = static_cast<unsigned char>(str[i]);
+
+        std::size_t length;
+        char32_t c;
+        if (lead < 0x80u)      { length = 1u; c = lead; }
+        else if (lead < 0xC2u) { length = 0u; c = 0; }
+        else if (lead < 0xE0u) { length = 2u; c = lead & 0x1Fu; }
+        else if (lead < 0xF0u) { length = 3u; c = lead & 0x0Fu; }
+        else if (lead < 0xF5u) { length = 4u; c = lead & 0x07u; }
+        else                   { length = 0u; c = 0; }
+
+        bool valid = length != 0u && i + length <= size;
+        for (std::size_t k = 1u; valid && k < length; ++k) {
+            const auto cont = static_cast<unsigned char>(str[i + k]);
+            valid = (cont & 0xC0u) == 0x80u;
+            c = (c << 6) | (cont & 0x3Fu);
+        }
+
+        if (valid) {
+            out += fold_case(c);
+            i += length;
+        }
+        else {
+            out += char32_t(0xFFFD);
+            ++i;
+        }
+    }
+}
+
+// Appends c to out as UTF-8
+inline void utf8_encode(char32_t c, std::string &out) {
+    if (c < 0x80u) {
+        out += static_cast<char>(c);
+    }
+    else if (c < 0x800u) {
+        out += static_cast<char>(0xC0u | (c >> 6));
+        out += static_cast<char>(0x80u | (c & 0x3Fu));
+    }
+    else if (c < 0x10000u) {
+        out += static_cast<char>(0xE0u | (c >> 12));
+        out += static_cast<char>(0x80u | ((c >> 6) & 0x3Fu));
+        out += static_cast<char>(0x80u | (c & 0x3Fu));
+    }
+    else {
+        out += static_cast<char>(0xF0u | (c >> 18));
+        out += static_cast<char>(0x80u | ((c >> 12) & 0x3Fu));
+        out += static_cast<char>(0x80u | ((c >> 6) & 0x3Fu));
+        out += static_cast<char>(0x80u | (c & 0x3Fu));
+    }
+}
+
+// Replaces the last code point of str, which must be complete, with its folded form.
+// A malformed tail is left as it is.
+inline void utf8_fold_last(std::string &str) {
+    std::size_t start = str.size();
+    while (start > 0u && (static_cast<unsigned char>(str[start - 1u]) & 0xC0u) == 0x80u) --start;
+    if (start == 0u) return;
+    --start;
+
+    std::u32string decoded;
+    utf8_decode_folded(std::string_view{ str }.substr(start), decoded);
+    if (decoded.size() != 1u || decoded.front() == char32_t(0xFFFD)) return;
+
+    str.erase(start);
+    utf8_encode(decoded.front(), str);
+}
+
+#endif // UTF8_HPP